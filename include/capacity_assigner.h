@@ -0,0 +1,29 @@
+#ifndef CAPACITY_ASSIGNER_H_
+#define CAPACITY_ASSIGNER_H_
+
+#include <vector>
+
+class CapacityAssigner {
+ public:
+  CapacityAssigner(const std::vector<std::vector<double>>& cluster_centers,
+                   const std::vector<int>& occupancy, int candidate_num = 8);
+  double Assign(const std::vector<std::vector<double>>& batch,
+                std::vector<int>* assignments);
+  // Returns a negative value, leaving the occupancy unchanged, if the clusters
+  // have less free capacity than the batch needs.
+  double Assign(const std::vector<std::vector<double>>& batch, int capacity,
+                std::vector<int>* assignments);
+  const std::vector<int>& occupancy() const;
+
+ private:
+  void FindCandidates(const std::vector<double>& point,
+                      const std::vector<int>& remaining,
+                      std::vector<std::pair<double, int>>* candidates) const;
+  const int k_;
+  const int candidate_num_;
+  const std::vector<std::vector<double>> cluster_centers_;
+  std::vector<int> occupancy_;
+  std::vector<std::pair<double, int>> sorted_norms_;
+};
+
+#endif  // CAPACITY_ASSIGNER_H_
@@ -0,0 +1,41 @@
+#ifndef CHUNK_READER_H_
+#define CHUNK_READER_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+class ChunkReader {
+ public:
+  virtual ~ChunkReader() {}
+  virtual void Reset() = 0;
+  virtual bool Read(int chunk_size,
+                    std::vector<std::vector<double>>* chunk) = 0;
+};
+
+class CsvChunkReader : public ChunkReader {
+ public:
+  explicit CsvChunkReader(const std::string& file_name);
+  void Reset() override;
+  bool Read(int chunk_size, std::vector<std::vector<double>>* chunk) override;
+
+ private:
+  std::ifstream file_;
+};
+
+// Binary files start with two int32 values, the number of rows and columns,
+// followed by the rows as contiguous doubles in native byte order.
+class BinaryChunkReader : public ChunkReader {
+ public:
+  explicit BinaryChunkReader(const std::string& file_name);
+  void Reset() override;
+  bool Read(int chunk_size, std::vector<std::vector<double>>* chunk) override;
+
+ private:
+  std::ifstream file_;
+  int n_;
+  int s_;
+  int row_;
+};
+
+#endif  // CHUNK_READER_H_
@@ -0,0 +1,46 @@
+#ifndef HIERARCHICAL_K_MEANS_H_
+#define HIERARCHICAL_K_MEANS_H_
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "k_means.h"
+#include "worker_pool.h"
+
+class HierarchicalKMeans : public KMeans {
+ public:
+  HierarchicalKMeans(const std::vector<std::vector<double>>& data, int k,
+                     int branching = 0, bool refine = false,
+                     InitMethod init_method = KMeans::kForgy,
+                     bool warm_start = true, int n_jobs = 1,
+                     unsigned int seed = std::random_device{}(),
+                     int pricing_block = 0, bool exact = false);
+  double Solve();
+
+ protected:
+  struct Node {
+    std::vector<int> indices;
+    int first_cluster;
+    int cluster_num;
+  };
+  void Split(const Node& node, unsigned int seed, int n_jobs,
+             std::vector<Node>* children) const;
+  void Refine();
+  template <class Solver>
+  void RefineGroup(const std::vector<int>& clusters,
+                   const std::vector<std::vector<int>>& members, int n_jobs);
+  void ParallelFor(int task_num, const std::function<void(int)>& task);
+  const int branching_;
+  const bool refine_;
+  const bool warm_start_;
+  const int n_jobs_;
+  const int pricing_block_;
+  const bool exact_;
+  const int lower_bound_;
+  const int upper_bound_;
+  std::unique_ptr<WorkerPool> pool_;
+};
+
+#endif  // HIERARCHICAL_K_MEANS_H_
@@ -12,11 +12,21 @@ class KMeans {
   const std::vector<std::vector<double>>& cluster_centers() const;
   const std::vector<int>& assignments() const;
   double GetSumSquaredError() const;
+  void set_sketch_dimension(int sketch_dimension);
+  static double CalDistance(const std::vector<double>& data1,
+                            const std::vector<double>& data2);
+  static std::vector<int> SampleIndices(int n, int k,
+                                        std::default_random_engine* el);
 
  protected:
   void Init();
-  double CalDistance(const std::vector<double>& data1,
-                     const std::vector<double>& data2) const;
+  double CalSketchDistance(const std::vector<double>& sketch1,
+                           const std::vector<double>& sketch2) const;
+  double CalSketchUpperBound(const std::vector<double>& sketch1,
+                             const std::vector<double>& sketch2) const;
+  void BuildSketch();
+  void UpdateCenterSketch();
+  std::vector<double> GetSketch(const std::vector<double>& data) const;
   void UpdateClusterCenter();
   void InitWithRandomCenter();
   void InitWithRandomAssignment();
@@ -29,6 +39,11 @@ class KMeans {
   std::vector<std::vector<double>> cluster_centers_;
   std::vector<int> assignments_;
   std::default_random_engine el_;
+  int sketch_dimension_;
+  std::vector<double> sketch_mean_;
+  std::vector<std::vector<double>> sketch_basis_;
+  std::vector<std::vector<double>> data_sketch_;
+  std::vector<std::vector<double>> cluster_center_sketch_;
 };
 
 #endif  // K_MEANS_H_
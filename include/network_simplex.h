@@ -1,26 +1,54 @@
 #ifndef NETWORK_SIMPLEX_H_
 #define NETWORK_SIMPLEX_H_
 
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <vector>
 
-class NetworkSimplex {
+#include "worker_pool.h"
+
+// Cost is either double, or int64_t for the exact mode, in which the costs
+// are scaled and rounded to integers and the pivots keep the spanning tree
+// strongly feasible.
+template <class Cost>
+class BasicNetworkSimplex {
  public:
   void BuildHard(const std::vector<std::vector<double>>& costs, int k,
                  int lower_bound, int upper_bound);
+  // Returns false, leaving the solver empty, unless every cluster can hold
+  // between its lower and upper bound with all points assigned.
+  bool BuildHard(const std::vector<std::vector<double>>& costs,
+                 const std::vector<int>& lower_bounds,
+                 const std::vector<int>& upper_bounds);
+  static bool IsFeasible(int n, const std::vector<int>& lower_bounds,
+                         const std::vector<int>& upper_bounds);
   void Build(const std::vector<std::vector<double>>& costs,
              const std::function<double(int, int)>& f);
+  void SetBlockPricing(int block_size, int n_jobs);
   void Simplex();
   void UpdateCosts(const std::vector<std::vector<double>>& costs);
   void GetAssignments(std::vector<int>* assignments) const;
+  void GetPotentials(std::vector<double>* potentials);
   double min_cost() const;
+  double cost_error_bound() const;
 
  private:
   std::vector<int> BuildBasic(const std::vector<std::vector<double>>& costs,
                               int extra_edge_num_);
+  std::vector<int> BuildBasic(const std::vector<std::vector<double>>& costs,
+                              const std::vector<int>& cluster_sizes,
+                              int extra_edge_num_);
   void BuildTree();
-  void Pivot(int edge_index, int direction, double delta);
-  double GetPotential(int u);
+  void MakeStronglyFeasible();
+  bool UpdateScale(const std::vector<std::vector<double>>& costs);
+  Cost ToCost(double cost) const;
+  void BlockSimplex();
+  void UpdateBlockPotentials(int begin, int end);
+  void PriceBlock(int begin, int end, int block_start, Cost* best_delta,
+                  int* best_position);
+  void Pivot(int edge_index, int direction, Cost delta);
+  Cost GetPotential(int u);
   int GetParentResCap(int u, int direction);
   void ApplyParentFlow(int u, int direction, int flow);
   void ChangeDirection(int u, int end);
@@ -30,7 +58,7 @@ class NetworkSimplex {
     int to;
     int cap;
     int flow;
-    double cost;
+    Cost cost;
     bool in_tree;
   };
   std::vector<int> parent_;
@@ -38,13 +66,24 @@ class NetworkSimplex {
   std::vector<int> parent_direction_;
   std::vector<bool> vis_;
   std::vector<Edge> edge_list_;
-  std::vector<double> potential_;
+  std::vector<Cost> potential_;
   std::vector<int> potential_tag_;
+  std::vector<std::pair<int, int>> from_path_;
+  std::vector<std::pair<int, int>> to_path_;
   int tag_;
-  double min_cost_;
+  Cost min_cost_;
+  double scale_ = 1.0;
+  std::function<double(int, int)> f_;
+  double max_regularizer_cost_ = 0.0;
   int n_;
   int k_;
+  int block_size_ = 0;
+  int n_jobs_ = 1;
+  std::unique_ptr<WorkerPool> pool_;
   static constexpr double kEps = 1e-6;
 };
 
+typedef BasicNetworkSimplex<double> NetworkSimplex;
+typedef BasicNetworkSimplex<int64_t> ExactNetworkSimplex;
+
 #endif  // NETWORK_SIMPLEX_H_
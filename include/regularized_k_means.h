@@ -13,17 +13,36 @@ class RegularizedKMeans : public KMeans {
   RegularizedKMeans(const std::vector<std::vector<double>>& data, int k,
                     InitMethod init_method = KMeans::kForgy,
                     bool warm_start = true, int n_jobs = 1,
-                    unsigned int seed = std::random_device{}());
+                    unsigned int seed = std::random_device{}(),
+                    int pricing_block = 0, bool exact = false);
   double SolveHard();
   double SolveHard(int lower_bound, int upper_bound);
+  // Returns a negative value if the bounds cannot be met.
+  double SolveHard(const std::vector<int>& lower_bounds,
+                   const std::vector<int>& upper_bounds);
   double Solve(const std::function<double(int, int)>& f);
+  // Bound on how far the last assignment of the exact mode can be from the
+  // optimum for its centers, due to rounding the costs. Zero otherwise.
+  double cost_error_bound() const;
 
  protected:
-  double Solve(std::function<NetworkSimplex()> builder);
+  template <class Solver>
+  double Solve(std::function<Solver()> builder);
   void UpdateCostMatrix();
+  void UpdateScreenedCosts(int i);
+  template <class Solver>
+  bool RefineCostMatrix(Solver& ns_solver);
   const bool warm_start_;
   const int n_jobs_;
+  const int pricing_block_;
+  const bool exact_;
   std::vector<std::vector<double>> costs_;
+  double cost_error_bound_;
+  // Arcs whose cost is the exact distance when screening with the sketch. The
+  // others hold the sketch upper bound until their lower bound shows that
+  // they could enter the assignment.
+  std::vector<std::vector<bool>> exact_costs_;
+  static constexpr int kSketchCandidates = 2;
 };
 
 #endif  // REGULARIZED_K_MEANS_H_
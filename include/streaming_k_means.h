@@ -0,0 +1,39 @@
+#ifndef STREAMING_K_MEANS_H_
+#define STREAMING_K_MEANS_H_
+
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "chunk_reader.h"
+
+class StreamingKMeans {
+ public:
+  StreamingKMeans(ChunkReader* reader, int k, int chunk_size,
+                  unsigned int seed = std::random_device{}());
+  const std::vector<std::vector<double>>& cluster_centers() const;
+  // Returns a negative value if the data has fewer than k points.
+  double Solve(int passes);
+  // Assigns every point to the final centers, holding the cluster sizes to
+  // n/k..ceil(n/k) over the whole file. Must follow Solve.
+  double Assign(const std::function<void(int)>& output);
+
+ private:
+  bool Init();
+  std::vector<int> Capacity() const;
+  // Fills the chunk within the capacity left in every cluster and takes the
+  // assigned points from it.
+  double AssignChunk(const std::vector<std::vector<double>>& chunk,
+                     std::vector<int>* capacity,
+                     std::vector<int>* assignments) const;
+  ChunkReader* reader_;
+  const int k_;
+  const int chunk_size_;
+  int s_;
+  int n_;
+  std::vector<int> cluster_sizes_;
+  std::vector<std::vector<double>> cluster_centers_;
+  std::default_random_engine el_;
+};
+
+#endif  // STREAMING_K_MEANS_H_
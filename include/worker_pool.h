@@ -0,0 +1,37 @@
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads that stay alive between rounds. Idle workers spin briefly and then
+// sleep on a condition variable, so they do not compete with the calling
+// thread for the cores while it runs serial work.
+class WorkerPool {
+ public:
+  explicit WorkerPool(int n_jobs);
+  ~WorkerPool();
+  int n_jobs() const;
+  // Runs task(t) for every t in [0, n_jobs), task(0) on the calling thread,
+  // and returns once all of them finish.
+  void Run(const std::function<void(int)>& task);
+
+ private:
+  void Work(int t);
+  const int n_jobs_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const std::function<void(int)>* task_;
+  std::atomic<int> round_;
+  std::atomic<int> pending_;
+  bool stop_;
+  static constexpr int kSpinCount = 2000;
+};
+
+#endif  // WORKER_POOL_H_
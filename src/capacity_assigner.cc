@@ -0,0 +1,193 @@
+#include "capacity_assigner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "k_means.h"
+#include "network_simplex.h"
+
+namespace {
+
+double Norm(const std::vector<double>& data) {
+  double result = 0.0;
+  for (auto value : data) {
+    result += value * value;
+  }
+  return std::sqrt(result);
+}
+
+}  // namespace
+
+CapacityAssigner::CapacityAssigner(
+    const std::vector<std::vector<double>>& cluster_centers,
+    const std::vector<int>& occupancy, int candidate_num)
+    : k_(static_cast<int>(cluster_centers.size())),
+      candidate_num_(std::max(1, candidate_num)),
+      cluster_centers_(cluster_centers),
+      occupancy_(occupancy),
+      sorted_norms_(k_) {
+  occupancy_.resize(k_, 0);
+  for (int j = 0; j < k_; ++j) {
+    sorted_norms_[j] = std::make_pair(Norm(cluster_centers_[j]), j);
+  }
+  std::sort(sorted_norms_.begin(), sorted_norms_.end());
+}
+
+const std::vector<int>& CapacityAssigner::occupancy() const {
+  return occupancy_;
+}
+
+double CapacityAssigner::Assign(const std::vector<std::vector<double>>& batch,
+                                std::vector<int>* assignments) {
+  int total = static_cast<int>(batch.size());
+  for (auto size : occupancy_) {
+    total += size;
+  }
+  return Assign(batch, (total + k_ - 1) / k_, assignments);
+}
+
+double CapacityAssigner::Assign(const std::vector<std::vector<double>>& batch,
+                                int capacity, std::vector<int>* assignments) {
+  int m = static_cast<int>(batch.size());
+  std::vector<int> remaining(k_);
+  int free_capacity = 0;
+  for (int j = 0; j < k_; ++j) {
+    remaining[j] = std::max(0, capacity - occupancy_[j]);
+    free_capacity += remaining[j];
+  }
+  if (free_capacity < m) {
+    assignments->clear();
+    return -1.0;
+  }
+  std::vector<std::vector<std::pair<double, int>>> candidates(m);
+  std::vector<int> demand(k_, 0);
+  for (int i = 0; i < m; ++i) {
+    FindCandidates(batch[i], remaining, &candidates[i]);
+    ++demand[candidates[i].front().second];
+  }
+  // Over-demanded points and every point competing for their candidate
+  // clusters go through the min-cost flow; the rest take their nearest center.
+  std::vector<int> column_index(k_, -1);
+  std::vector<int> columns;
+  for (int i = 0; i < m; ++i) {
+    if (demand[candidates[i].front().second] >
+        remaining[candidates[i].front().second]) {
+      for (const auto& candidate : candidates[i]) {
+        if (column_index[candidate.second] == -1) {
+          column_index[candidate.second] = static_cast<int>(columns.size());
+          columns.emplace_back(candidate.second);
+        }
+      }
+    }
+  }
+  assignments->resize(m);
+  std::vector<int> contended;
+  for (int i = 0; i < m; ++i) {
+    int nearest = candidates[i].front().second;
+    if (column_index[nearest] == -1) {
+      (*assignments)[i] = nearest;
+      --remaining[nearest];
+    } else {
+      contended.emplace_back(i);
+    }
+  }
+  if (!contended.empty()) {
+    int capacity_sum = 0;
+    for (int cluster : columns) {
+      capacity_sum += remaining[cluster];
+    }
+    if (capacity_sum < static_cast<int>(contended.size())) {
+      // Spare clusters are added by their distance to the nearest contended
+      // point until they can take every contended point.
+      std::vector<std::pair<double, int>> spare;
+      for (int j = 0; j < k_; ++j) {
+        if (column_index[j] == -1 && remaining[j] > 0) {
+          double distance = std::numeric_limits<double>::max();
+          for (int i : contended) {
+            distance = std::min(
+                distance, KMeans::CalDistance(batch[i], cluster_centers_[j]));
+          }
+          spare.emplace_back(distance, j);
+        }
+      }
+      std::sort(spare.begin(), spare.end());
+      for (int c = 0; c < static_cast<int>(spare.size()) &&
+                      capacity_sum < static_cast<int>(contended.size());
+           ++c) {
+        int j = spare[c].second;
+        column_index[j] = static_cast<int>(columns.size());
+        columns.emplace_back(j);
+        capacity_sum += remaining[j];
+      }
+    }
+    int column_num = static_cast<int>(columns.size());
+    std::vector<std::vector<double>> costs(
+        contended.size(), std::vector<double>(column_num));
+    for (int i = 0; i < static_cast<int>(contended.size()); ++i) {
+      for (int j = 0; j < column_num; ++j) {
+        costs[i][j] = KMeans::CalDistance(batch[contended[i]],
+                                          cluster_centers_[columns[j]]);
+      }
+    }
+    std::vector<int> upper_bounds(column_num);
+    for (int j = 0; j < column_num; ++j) {
+      upper_bounds[j] = remaining[columns[j]];
+    }
+    NetworkSimplex ns_solver = NetworkSimplex();
+    ns_solver.BuildHard(costs, std::vector<int>(column_num, 0), upper_bounds);
+    ns_solver.Simplex();
+    std::vector<int> local_assignments;
+    ns_solver.GetAssignments(&local_assignments);
+    for (int i = 0; i < static_cast<int>(contended.size()); ++i) {
+      (*assignments)[contended[i]] = columns[local_assignments[i]];
+    }
+  }
+  double sum = 0.0;
+  for (int i = 0; i < m; ++i) {
+    ++occupancy_[(*assignments)[i]];
+    sum += KMeans::CalDistance(batch[i], cluster_centers_[(*assignments)[i]]);
+  }
+  return sum;
+}
+
+void CapacityAssigner::FindCandidates(
+    const std::vector<double>& point, const std::vector<int>& remaining,
+    std::vector<std::pair<double, int>>* candidates) const {
+  // Centers are scanned outwards by norm until (|x| - |c|)^2 bounds them out.
+  double norm = Norm(point);
+  candidates->clear();
+  int right = static_cast<int>(
+      std::lower_bound(sorted_norms_.begin(), sorted_norms_.end(),
+                       std::make_pair(norm, -1)) -
+      sorted_norms_.begin());
+  int left = right - 1;
+  while (left >= 0 || right < k_) {
+    int pos;
+    if (right >= k_ || (left >= 0 && norm - sorted_norms_[left].first <
+                                         sorted_norms_[right].first - norm)) {
+      pos = left--;
+    } else {
+      pos = right++;
+    }
+    double gap = sorted_norms_[pos].first - norm;
+    if (static_cast<int>(candidates->size()) == candidate_num_ &&
+        gap * gap >= candidates->front().first) {
+      break;
+    }
+    int cluster = sorted_norms_[pos].second;
+    if (remaining[cluster] == 0) {
+      continue;
+    }
+    double distance = KMeans::CalDistance(point, cluster_centers_[cluster]);
+    if (static_cast<int>(candidates->size()) < candidate_num_) {
+      candidates->emplace_back(distance, cluster);
+      std::push_heap(candidates->begin(), candidates->end());
+    } else if (distance < candidates->front().first) {
+      std::pop_heap(candidates->begin(), candidates->end());
+      candidates->back() = std::make_pair(distance, cluster);
+      std::push_heap(candidates->begin(), candidates->end());
+    }
+  }
+  std::sort_heap(candidates->begin(), candidates->end());
+}
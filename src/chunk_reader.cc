@@ -0,0 +1,65 @@
+#include "chunk_reader.h"
+
+#include <cstdint>
+#include <sstream>
+
+CsvChunkReader::CsvChunkReader(const std::string& file_name)
+    : file_(file_name) {}
+
+void CsvChunkReader::Reset() {
+  file_.clear();
+  file_.seekg(0);
+}
+
+bool CsvChunkReader::Read(int chunk_size,
+                          std::vector<std::vector<double>>* chunk) {
+  chunk->clear();
+  std::string line;
+  while (static_cast<int>(chunk->size()) < chunk_size &&
+         std::getline(file_, line)) {
+    for (auto& c : line) {
+      if (c == ',') {
+        c = ' ';
+      }
+    }
+    std::stringstream ss(line);
+    std::vector<double> line_data;
+    double value;
+    while (ss >> value) {
+      line_data.emplace_back(value);
+    }
+    chunk->emplace_back(line_data);
+  }
+  return !chunk->empty();
+}
+
+BinaryChunkReader::BinaryChunkReader(const std::string& file_name)
+    : file_(file_name, std::ios::binary), n_(0), s_(0), row_(0) {
+  int32_t header[2] = {0, 0};
+  file_.read(reinterpret_cast<char*>(header), sizeof(header));
+  if (file_) {
+    n_ = header[0];
+    s_ = header[1];
+  }
+}
+
+void BinaryChunkReader::Reset() {
+  file_.clear();
+  file_.seekg(2 * sizeof(int32_t));
+  row_ = 0;
+}
+
+bool BinaryChunkReader::Read(int chunk_size,
+                             std::vector<std::vector<double>>* chunk) {
+  chunk->clear();
+  while (static_cast<int>(chunk->size()) < chunk_size && row_ < n_) {
+    std::vector<double> line_data(s_);
+    if (!file_.read(reinterpret_cast<char*>(line_data.data()),
+                    s_ * sizeof(double))) {
+      break;
+    }
+    chunk->emplace_back(line_data);
+    ++row_;
+  }
+  return !chunk->empty();
+}
@@ -0,0 +1,237 @@
+#include "hierarchical_k_means.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "network_simplex.h"
+#include "regularized_k_means.h"
+
+HierarchicalKMeans::HierarchicalKMeans(
+    const std::vector<std::vector<double>>& data, int k, int branching,
+    bool refine, InitMethod init_method, bool warm_start, int n_jobs,
+    unsigned int seed, int pricing_block, bool exact)
+    : KMeans(data, k, init_method, seed),
+      branching_(branching >= 2
+                     ? branching
+                     : std::max(2, static_cast<int>(std::ceil(std::sqrt(k))))),
+      refine_(refine),
+      warm_start_(warm_start),
+      n_jobs_(n_jobs == -1 ? std::thread::hardware_concurrency() : n_jobs),
+      pricing_block_(pricing_block),
+      exact_(exact),
+      lower_bound_(n_ / k_),
+      upper_bound_((n_ + k_ - 1) / k_) {}
+
+double HierarchicalKMeans::Solve() {
+  assignments_.assign(n_, 0);
+  std::vector<Node> level(1);
+  level[0].indices.resize(n_);
+  for (int i = 0; i < n_; ++i) {
+    level[0].indices[i] = i;
+  }
+  level[0].first_cluster = 0;
+  level[0].cluster_num = k_;
+  while (!level.empty()) {
+    std::vector<Node> internal;
+    for (auto& node : level) {
+      if (node.cluster_num == 1) {
+        for (int index : node.indices) {
+          assignments_[index] = node.first_cluster;
+        }
+      } else {
+        internal.emplace_back(std::move(node));
+      }
+    }
+    std::vector<unsigned int> seeds(internal.size());
+    for (auto& seed : seeds) {
+      seed = el_();
+    }
+    // Levels with fewer nodes than threads, like the root, hand the spare
+    // threads to the solver of each node.
+    int node_jobs =
+        std::max(1, n_jobs_ / std::max(1, static_cast<int>(internal.size())));
+    std::vector<std::vector<Node>> children(internal.size());
+    ParallelFor(static_cast<int>(internal.size()), [&](int t) {
+      Split(internal[t], seeds[t], node_jobs, &children[t]);
+    });
+    level.clear();
+    for (auto& siblings : children) {
+      for (auto& child : siblings) {
+        level.emplace_back(std::move(child));
+      }
+    }
+  }
+  UpdateClusterCenter();
+  if (refine_) {
+    Refine();
+  }
+  return GetSumSquaredError();
+}
+
+void HierarchicalKMeans::Split(const Node& node, unsigned int seed,
+                               int n_jobs, std::vector<Node>* children) const {
+  int branch_num = std::min(branching_, node.cluster_num);
+  std::vector<int> lower_bounds(branch_num);
+  std::vector<int> upper_bounds(branch_num);
+  children->resize(branch_num);
+  for (int i = 0, first_cluster = node.first_cluster; i < branch_num; ++i) {
+    int cluster_num = node.cluster_num / branch_num +
+                      (i < node.cluster_num % branch_num ? 1 : 0);
+    (*children)[i].first_cluster = first_cluster;
+    (*children)[i].cluster_num = cluster_num;
+    lower_bounds[i] = cluster_num * lower_bound_;
+    upper_bounds[i] = cluster_num * upper_bound_;
+    first_cluster += cluster_num;
+  }
+  std::vector<std::vector<double>> subset;
+  subset.reserve(node.indices.size());
+  for (int index : node.indices) {
+    subset.emplace_back(data_[index]);
+  }
+  RegularizedKMeans rkm(subset, branch_num, init_method_, warm_start_, n_jobs,
+                        seed, pricing_block_, exact_);
+  rkm.set_sketch_dimension(sketch_dimension_);
+  rkm.SolveHard(lower_bounds, upper_bounds);
+  for (int i = 0; i < static_cast<int>(node.indices.size()); ++i) {
+    (*children)[rkm.assignments()[i]].indices.emplace_back(node.indices[i]);
+  }
+}
+
+void HierarchicalKMeans::Refine() {
+  std::vector<std::vector<int>> members(k_);
+  for (int i = 0; i < n_; ++i) {
+    members[assignments_[i]].emplace_back(i);
+  }
+  std::vector<std::vector<int>> groups;
+  std::vector<bool> grouped(k_, false);
+  for (int i = 0; i < k_; ++i) {
+    if (grouped[i]) {
+      continue;
+    }
+    std::vector<std::pair<double, int>> candidates;
+    for (int j = i + 1; j < k_; ++j) {
+      if (!grouped[j]) {
+        candidates.emplace_back(
+            CalDistance(cluster_centers_[i], cluster_centers_[j]), j);
+      }
+    }
+    int neighbor_num =
+        std::min(branching_ - 1, static_cast<int>(candidates.size()));
+    std::partial_sort(candidates.begin(), candidates.begin() + neighbor_num,
+                      candidates.end());
+    std::vector<int> group(1, i);
+    grouped[i] = true;
+    for (int j = 0; j < neighbor_num; ++j) {
+      group.emplace_back(candidates[j].second);
+      grouped[candidates[j].second] = true;
+    }
+    groups.emplace_back(group);
+  }
+  int group_jobs =
+      std::max(1, n_jobs_ / std::max(1, static_cast<int>(groups.size())));
+  ParallelFor(static_cast<int>(groups.size()),
+              [this, &groups, &members, group_jobs](int t) {
+                if (exact_) {
+                  RefineGroup<ExactNetworkSimplex>(groups[t], members,
+                                                   group_jobs);
+                } else {
+                  RefineGroup<NetworkSimplex>(groups[t], members, group_jobs);
+                }
+              });
+}
+
+template <class Solver>
+void HierarchicalKMeans::RefineGroup(
+    const std::vector<int>& clusters,
+    const std::vector<std::vector<int>>& members, int n_jobs) {
+  int group_size = static_cast<int>(clusters.size());
+  if (group_size < 2) {
+    return;
+  }
+  std::vector<int> indices;
+  for (int cluster : clusters) {
+    indices.insert(indices.end(), members[cluster].begin(),
+                   members[cluster].end());
+  }
+  int m = static_cast<int>(indices.size());
+  std::vector<std::vector<double>> centers(group_size);
+  for (int j = 0; j < group_size; ++j) {
+    centers[j] = cluster_centers_[clusters[j]];
+  }
+  std::vector<std::vector<double>> costs(m, std::vector<double>(group_size));
+  auto update_costs = [&]() {
+    for (int i = 0; i < m; ++i) {
+      for (int j = 0; j < group_size; ++j) {
+        costs[i][j] = CalDistance(data_[indices[i]], centers[j]);
+      }
+    }
+  };
+  std::vector<int> local_assignments;
+  std::vector<int> old_assignments;
+  update_costs();
+  Solver ns_solver = Solver();
+  ns_solver.BuildHard(costs, group_size, lower_bound_, upper_bound_);
+  ns_solver.SetBlockPricing(pricing_block_, n_jobs);
+  ns_solver.Simplex();
+  ns_solver.GetAssignments(&local_assignments);
+  do {
+    old_assignments = local_assignments;
+    std::vector<int> cluster_size(group_size, 0);
+    for (int j = 0; j < group_size; ++j) {
+      std::fill(centers[j].begin(), centers[j].end(), 0.0);
+    }
+    for (int i = 0; i < m; ++i) {
+      ++cluster_size[local_assignments[i]];
+      for (int d = 0; d < s_; ++d) {
+        centers[local_assignments[i]][d] += data_[indices[i]][d];
+      }
+    }
+    for (int j = 0; j < group_size; ++j) {
+      if (cluster_size[j] > 0) {
+        for (auto& coordinate : centers[j]) {
+          coordinate /= cluster_size[j];
+        }
+      } else {
+        centers[j] = cluster_centers_[clusters[j]];
+      }
+    }
+    update_costs();
+    if (warm_start_) {
+      ns_solver.UpdateCosts(costs);
+    } else {
+      ns_solver = Solver();
+      ns_solver.BuildHard(costs, group_size, lower_bound_, upper_bound_);
+      ns_solver.SetBlockPricing(pricing_block_, n_jobs);
+    }
+    ns_solver.Simplex();
+    ns_solver.GetAssignments(&local_assignments);
+  } while (old_assignments != local_assignments);
+  for (int i = 0; i < m; ++i) {
+    assignments_[indices[i]] = clusters[local_assignments[i]];
+  }
+  for (int j = 0; j < group_size; ++j) {
+    cluster_centers_[clusters[j]] = centers[j];
+  }
+}
+
+void HierarchicalKMeans::ParallelFor(int task_num,
+                                     const std::function<void(int)>& task) {
+  int thread_num = std::min(n_jobs_, task_num);
+  if (thread_num <= 1) {
+    for (int t = 0; t < task_num; ++t) {
+      task(t);
+    }
+    return;
+  }
+  if (!pool_) {
+    pool_.reset(new WorkerPool(n_jobs_));
+  }
+  std::atomic<int> next_task(0);
+  pool_->Run([&next_task, &task, task_num](int) {
+    for (int t = next_task++; t < task_num; t = next_task++) {
+      task(t);
+    }
+  });
+}
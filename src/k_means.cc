@@ -1,5 +1,8 @@
 #include "k_means.h"
 
+#include <algorithm>
+#include <cmath>
+
 KMeans::KMeans(const std::vector<std::vector<double>>& data, int k,
                InitMethod init_method, unsigned int seed)
     : data_(data),
@@ -8,7 +11,8 @@ KMeans::KMeans(const std::vector<std::vector<double>>& data, int k,
       k_(k),
       init_method_(init_method),
       el_(seed),
-      seed_(seed) {}
+      seed_(seed),
+      sketch_dimension_(0) {}
 
 const std::vector<std::vector<double>>& KMeans::cluster_centers() const {
   return this->cluster_centers_;
@@ -19,14 +23,18 @@ const std::vector<int>& KMeans::assignments() const {
 }
 
 double KMeans::CalDistance(const std::vector<double>& data1,
-                           const std::vector<double>& data2) const {
+                           const std::vector<double>& data2) {
   double result = 0.0;
-  for (int i = 0; i < s_; ++i) {
+  for (int i = 0; i < static_cast<int>(data1.size()); ++i) {
     result += (data1[i] - data2[i]) * (data1[i] - data2[i]);
   }
   return result;
 }
 
+void KMeans::set_sketch_dimension(int sketch_dimension) {
+  sketch_dimension_ = sketch_dimension;
+}
+
 void KMeans::Init() {
   InitWithRandomAssignment();
   switch (init_method_) {
@@ -37,6 +45,127 @@ void KMeans::Init() {
       UpdateClusterCenter();
       break;
   }
+  data_sketch_.clear();
+  if (sketch_dimension_ > 0 && sketch_dimension_ < s_) {
+    BuildSketch();
+  }
+}
+
+double KMeans::CalSketchDistance(const std::vector<double>& sketch1,
+                                 const std::vector<double>& sketch2) const {
+  double result = 0.0;
+  for (int i = 0; i < static_cast<int>(sketch1.size()); ++i) {
+    result += (sketch1[i] - sketch2[i]) * (sketch1[i] - sketch2[i]);
+  }
+  return result;
+}
+
+double KMeans::CalSketchUpperBound(const std::vector<double>& sketch1,
+                                   const std::vector<double>& sketch2) const {
+  int d = static_cast<int>(sketch1.size()) - 1;
+  double result = 0.0;
+  for (int i = 0; i < d; ++i) {
+    result += (sketch1[i] - sketch2[i]) * (sketch1[i] - sketch2[i]);
+  }
+  result = std::sqrt(result) + sketch1[d] + sketch2[d];
+  return result * result;
+}
+
+// The sketch of a point holds its coordinates in an orthonormal basis found by
+// one power iteration on a sample, followed by the norm of the residual left
+// outside the basis. The squared distance between two sketches is therefore a
+// lower bound of the squared distance between the points.
+void KMeans::BuildSketch() {
+  std::default_random_engine el(seed_);
+  std::normal_distribution<double> normal;
+  sketch_mean_.assign(s_, 0.0);
+  for (const auto& point : data_) {
+    for (int j = 0; j < s_; ++j) {
+      sketch_mean_[j] += point[j] / n_;
+    }
+  }
+  int sample_size = std::min(n_, 1000);
+  std::vector<std::vector<double>> sample(sample_size);
+  for (auto& point : sample) {
+    point = data_[std::uniform_int_distribution<int>(0, n_ - 1)(el)];
+    for (int j = 0; j < s_; ++j) {
+      point[j] -= sketch_mean_[j];
+    }
+  }
+  std::vector<std::vector<double>> gaussian(
+      sketch_dimension_, std::vector<double>(s_));
+  for (auto& row : gaussian) {
+    for (auto& value : row) {
+      value = normal(el);
+    }
+  }
+  sketch_basis_.clear();
+  for (const auto& direction : gaussian) {
+    std::vector<double> basis(s_, 0.0);
+    for (const auto& point : sample) {
+      double dot = 0.0;
+      for (int j = 0; j < s_; ++j) {
+        dot += point[j] * direction[j];
+      }
+      for (int j = 0; j < s_; ++j) {
+        basis[j] += dot * point[j];
+      }
+    }
+    for (int pass = 0; pass < 2; ++pass) {
+      for (const auto& other : sketch_basis_) {
+        double dot = 0.0;
+        for (int j = 0; j < s_; ++j) {
+          dot += basis[j] * other[j];
+        }
+        for (int j = 0; j < s_; ++j) {
+          basis[j] -= dot * other[j];
+        }
+      }
+    }
+    double norm = 0.0;
+    for (auto value : basis) {
+      norm += value * value;
+    }
+    norm = std::sqrt(norm);
+    if (norm > 1e-12) {
+      for (auto& value : basis) {
+        value /= norm;
+      }
+      sketch_basis_.emplace_back(basis);
+    }
+  }
+  data_sketch_.resize(n_);
+  for (int i = 0; i < n_; ++i) {
+    data_sketch_[i] = GetSketch(data_[i]);
+  }
+}
+
+void KMeans::UpdateCenterSketch() {
+  cluster_center_sketch_.resize(k_);
+  for (int i = 0; i < k_; ++i) {
+    cluster_center_sketch_[i] = GetSketch(cluster_centers_[i]);
+  }
+}
+
+std::vector<double> KMeans::GetSketch(const std::vector<double>& data) const {
+  std::vector<double> centered(s_);
+  double residual = 0.0;
+  for (int j = 0; j < s_; ++j) {
+    centered[j] = data[j] - sketch_mean_[j];
+    residual += centered[j] * centered[j];
+  }
+  std::vector<double> sketch;
+  sketch.reserve(sketch_basis_.size() + 1);
+  for (const auto& basis : sketch_basis_) {
+    double dot = 0.0;
+    for (int j = 0; j < s_; ++j) {
+      dot += basis[j] * centered[j];
+    }
+    sketch.emplace_back(dot);
+    residual -= dot * dot;
+  }
+  sketch.emplace_back(std::sqrt(std::max(0.0, residual)));
+  return sketch;
 }
 
 void KMeans::UpdateClusterCenter() {
@@ -69,16 +198,23 @@ double KMeans::GetSumSquaredError() const {
   return sum;
 }
 
-void KMeans::InitWithRandomCenter() {
-  cluster_centers_.resize(k_);
-  std::vector<int> indices(n_);
-  for (int i = 0; i < n_; ++i) {
+std::vector<int> KMeans::SampleIndices(int n, int k,
+                                      std::default_random_engine* el) {
+  std::vector<int> indices(n);
+  for (int i = 0; i < n; ++i) {
     indices[i] = i;
   }
-  for (int i = 0; i < k_; ++i) {
-    int pos = std::uniform_int_distribution<int>(i, n_ - 1)(el_);
+  for (int i = 0; i < k; ++i) {
+    int pos = std::uniform_int_distribution<int>(i, n - 1)(*el);
     std::swap(indices[i], indices[pos]);
   }
+  indices.resize(k);
+  return indices;
+}
+
+void KMeans::InitWithRandomCenter() {
+  cluster_centers_.resize(k_);
+  std::vector<int> indices = SampleIndices(n_, k_, &el_);
   for (int i = 0; i < k_; ++i) {
     cluster_centers_[i] = data_[indices[i]];
   }
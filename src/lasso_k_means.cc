@@ -9,6 +9,9 @@ LassoKMeans::LassoKMeans(const std::vector<std::vector<double>>& data, int k,
 double LassoKMeans::Solve(double lambda) {
   Init();
   while (true) {
+    if (!data_sketch_.empty()) {
+      UpdateCenterSketch();
+    }
     std::vector<int> cluster_size(k_, 0);
     for (int i = 0; i < n_; ++i) {
       ++cluster_size[assignments_[i]];
@@ -24,9 +27,17 @@ double LassoKMeans::Solve(double lambda) {
         if (j == assignments_[i]) {
           continue;
         }
-        double delta = base + CalDistance(data_[i], cluster_centers_[j]) +
-                       lambda * Square(cluster_size[j] + 1) -
-                       lambda * Square(cluster_size[j]);
+        double regularizer = lambda * Square(cluster_size[j] + 1) -
+                             lambda * Square(cluster_size[j]);
+        if (!data_sketch_.empty() &&
+            base + regularizer +
+                    CalSketchDistance(data_sketch_[i],
+                                      cluster_center_sketch_[j]) >=
+                best_value) {
+          continue;
+        }
+        double delta =
+            base + CalDistance(data_[i], cluster_centers_[j]) + regularizer;
         if (delta < best_value) {
           best_value = delta;
           best_cluster = j;
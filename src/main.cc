@@ -1,33 +1,24 @@
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <limits>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
 #include <args.hxx>
 
+#include "capacity_assigner.h"
+#include "chunk_reader.h"
+#include "hierarchical_k_means.h"
 #include "lasso_k_means.h"
 #include "regularized_k_means.h"
+#include "streaming_k_means.h"
 
 std::vector<std::vector<double>> ReadData(const std::string& file_name) {
   std::vector<std::vector<double>> data;
-  std::ifstream file(file_name);
-  std::string line;
-  while (std::getline(file, line)) {
-    for (auto& c : line) {
-      if (c == ',') {
-        c = ' ';
-      }
-    }
-    std::stringstream ss(line);
-    std::vector<double> line_data;
-    double value;
-    while (ss >> value) {
-      line_data.emplace_back(value);
-    }
-    data.emplace_back(line_data);
-  }
+  CsvChunkReader(file_name).Read(std::numeric_limits<int>::max(), &data);
   return data;
 }
 
@@ -42,6 +33,17 @@ std::string GetKeyByValue(const std::unordered_map<std::string, T>& map,
   return std::string();
 }
 
+std::string InsertSuffix(const std::string& file_name,
+                         const std::string& suffix) {
+  auto dot = file_name.find_last_of('.');
+  auto slash = file_name.find_last_of("/\\");
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash)) {
+    return file_name + suffix;
+  }
+  return file_name.substr(0, dot) + suffix + file_name.substr(dot);
+}
+
 void WriteAssignments(const std::string& file_name,
                       const std::vector<int>& assignments) {
   std::ofstream file(file_name);
@@ -68,11 +70,15 @@ void WriteClusterCenters(
 }
 
 int main(int argc, char* argv[]) {
-  enum AlgorithmType { kHard, kSoft, kLasso };
+  enum AlgorithmType { kHard, kSoft, kLasso, kHierarchical, kAssign,
+                       kStream };
   std::unordered_map<std::string, AlgorithmType> type_map{
       {"hard", AlgorithmType::kHard},
       {"soft", AlgorithmType::kSoft},
-      {"lasso", AlgorithmType::kLasso}};
+      {"lasso", AlgorithmType::kLasso},
+      {"hierarchical", AlgorithmType::kHierarchical},
+      {"assign", AlgorithmType::kAssign},
+      {"stream", AlgorithmType::kStream}};
   std::unordered_map<std::string, RegularizedKMeans::InitMethod>
       init_method_map{{"forgy", RegularizedKMeans::kForgy},
                       {"rp", RegularizedKMeans::kRandomPartition}};
@@ -94,7 +100,16 @@ int main(int argc, char* argv[]) {
       "- 'soft': with lambda*x^2 regularization\n"
       "- 'lasso': our implementation of the\n"
       "           lasso k-means algorithm\n"
-      "           proposed by Li et al. [2018].",
+      "           proposed by Li et al. [2018].\n"
+      "- 'hierarchical': 'hard' for large k\n"
+      "                  by recursively\n"
+      "                  splitting the data.\n"
+      "- 'assign': assign new data to the\n"
+      "            nearest saved center that\n"
+      "            still has capacity.\n"
+      "- 'stream': 'hard' on chunks read\n"
+      "            from disk for data larger\n"
+      "            than memory.",
       type_map);
   args::Positional<std::string> file(required, "file", "Data file");
   args::Positional<int> k(required, "k", "Number of clusters");
@@ -122,11 +137,78 @@ int main(int argc, char* argv[]) {
       "Number of threads for parallel computing of the cost matrix, or '-1' "
       "for auto detecting the hardware concurrency. Default is 1.",
       {'t', "threads"}, 1);
+  args::ValueFlag<int> pricing_block(
+      parser, "block",
+      "Price the network simplex in blocks of [block] arcs, scanned by the "
+      "threads of -t. The result does not depend on the number of threads. "
+      "Default is 0, which pivots on the first eligible arc.",
+      {'p', "pricing-block"}, 0);
+  args::Flag exact(parser, "exact",
+                   "Run the network simplex on costs scaled and rounded to "
+                   "64-bit integers, and report the bound on the rounding "
+                   "error",
+                   {'x', "exact"});
+  args::ValueFlag<int> sketch(
+      parser, "dimension",
+      "Screen the candidate clusters of 'hard', 'soft', 'lasso' and the "
+      "splits of 'hierarchical' with a sketch of [dimension] features, "
+      "computing exact distances only where they can change the assignment. "
+      "Default is 0, which turns it off.",
+      {'d', "sketch"}, 0);
   args::ValueFlag<unsigned int> seed(parser, "seed", "Random seed",
                                      {'s', "seed"}, std::random_device{}());
   args::ValueFlag<double> lambda(
       parser, "lambda", "Lambda (required when type equals 'soft' or 'lasso')",
       {'l', "lambda"}, 0);
+  args::ValueFlag<int> branching(
+      parser, "branching",
+      "Number of children per split when type equals 'hierarchical'. "
+      "Default is ceil(sqrt(k)).",
+      {'b', "branching"}, 0);
+  args::Flag refine(parser, "refine",
+                    "Refine the 'hierarchical' result among neighboring "
+                    "clusters",
+                    {"refine"});
+  args::ValueFlag<std::string> centers_file(
+      parser, "file",
+      "Read the saved cluster centers from [file] (required when type equals "
+      "'assign')",
+      {"centers"});
+  args::ValueFlag<std::string> occupancy_file(
+      parser, "file",
+      "Per-cluster occupancy, one count per line. 'assign' reads it from and "
+      "writes it back into [file]; other types write the cluster sizes. If "
+      "multiple runs is enabled, '-<i>' is inserted before the extension of "
+      "[file] in i-th run.",
+      {'u', "occupancy"});
+  args::ValueFlag<int> capacity(
+      parser, "capacity",
+      "Maximum size of each cluster when type equals 'assign'. Default is "
+      "ceil(total/k) after each batch.",
+      {"capacity"}, 0);
+  args::ValueFlag<int> batch(
+      parser, "batch",
+      "Number of points per batch when type equals 'assign'. Default is the "
+      "whole file.",
+      {"batch"}, 0);
+  args::ValueFlag<int> chunk(
+      parser, "chunk",
+      "Number of points per chunk when type equals 'stream'. Default is "
+      "10000.",
+      {"chunk"}, 10000);
+  args::ValueFlag<int> passes(
+      parser, "passes",
+      "Maximum number of passes over the file when type equals 'stream'. "
+      "Default is 10.",
+      {"passes"}, 10);
+  args::Flag binary(parser, "binary",
+                    "Read the data file as int32 rows, int32 columns and "
+                    "then row-major doubles",
+                    {"binary"});
+  args::Flag final_pass(parser, "final-pass",
+                        "Assign the whole file to the final centers when "
+                        "type equals 'stream'. Implied by -a and -u.",
+                        {"final-pass"});
   args::ValueFlag<int> runs(parser, "runs", "Number of runs", {'r', "runs"}, 1);
   args::ValueFlag<std::string> assignment_file(
       parser, "file",
@@ -159,20 +241,179 @@ int main(int argc, char* argv[]) {
     std::cerr << parser;
     return 1;
   }
+  auto write_summary = [&](unsigned int run_seed, double result,
+                           double used_time) {
+    if (args::get(summary_file).empty()) {
+      return;
+    }
+    std::fstream out;
+    out.open(args::get(summary_file), std::fstream::app);
+    out << GetKeyByValue(type_map, args::get(type)) << ',' << args::get(file)
+        << ',' << args::get(k) << ','
+        << GetKeyByValue(init_method_map, args::get(init_method)) << ','
+        << std::boolalpha << !no_warm_start << ',' << args::get(threads) << ','
+        << run_seed << ',' << args::get(lambda) << ',' << result << ','
+        << used_time << std::endl;
+  };
+  if (args::get(type) == AlgorithmType::kStream) {
+    if (args::get(chunk) <= 0) {
+      std::cerr << "Expected a positive chunk size" << std::endl;
+      return 1;
+    }
+    std::unique_ptr<ChunkReader> reader;
+    if (binary) {
+      reader.reset(new BinaryChunkReader(args::get(file)));
+    } else {
+      reader.reset(new CsvChunkReader(args::get(file)));
+    }
+    for (int run = 1; run <= args::get(runs); ++run) {
+      auto start_time = std::chrono::high_resolution_clock::now();
+      StreamingKMeans skm(reader.get(), args::get(k), args::get(chunk),
+                          args::get(seed) + run - 1);
+      double result = skm.Solve(args::get(passes));
+      if (result < 0.0) {
+        std::cerr << "Expected at least " << args::get(k) << " points in '"
+                  << args::get(file) << "'" << std::endl;
+        return 1;
+      }
+      bool exact_result = false;
+      std::string run_suffix =
+          args::get(runs) == 1 ? "" : "-" + std::to_string(run);
+      if (final_pass || !args::get(assignment_file).empty() ||
+          !args::get(occupancy_file).empty()) {
+        std::ofstream out;
+        if (!args::get(assignment_file).empty()) {
+          out.open(args::get(assignment_file) + run_suffix + ".csv");
+        }
+        std::vector<int> cluster_size(args::get(k), 0);
+        result = skm.Assign([&out, &cluster_size](int assignment) {
+          ++cluster_size[assignment];
+          if (out.is_open()) {
+            out << assignment << '\n';
+          }
+        });
+        exact_result = true;
+        if (!args::get(occupancy_file).empty()) {
+          WriteAssignments(InsertSuffix(args::get(occupancy_file), run_suffix),
+                           cluster_size);
+        }
+      }
+      double used_time =
+          std::chrono::duration_cast<std::chrono::duration<double>>(
+              std::chrono::high_resolution_clock::now() - start_time)
+              .count();
+      if (!args::get(cluster_center_file).empty()) {
+        WriteClusterCenters(
+            args::get(cluster_center_file) + run_suffix + ".csv",
+            skm.cluster_centers());
+      }
+      write_summary(args::get(seed) + run - 1, result, used_time);
+      // Without the final pass the sum is taken against centers that move
+      // between chunks, so it is not the error of any single assignment.
+      std::cerr << (exact_result ? "Sum of Squares: "
+                                 : "Sum of Squares (moving centers): ")
+                << result << std::endl;
+      std::cerr << "Used Time: " << used_time << std::endl;
+    }
+    return 0;
+  }
   auto data = ReadData(args::get(file));
+  if (args::get(type) == AlgorithmType::kAssign) {
+    auto cluster_centers = ReadData(args::get(centers_file));
+    if (static_cast<int>(cluster_centers.size()) != args::get(k)) {
+      std::cerr << "Expected " << args::get(k) << " cluster centers in '"
+                << args::get(centers_file) << "'" << std::endl;
+      return 1;
+    }
+    auto dimension = cluster_centers.front().size();
+    for (const auto& cluster_center : cluster_centers) {
+      if (cluster_center.size() != dimension) {
+        std::cerr << "Expected " << dimension << " columns in every row of '"
+                  << args::get(centers_file) << "'" << std::endl;
+        return 1;
+      }
+    }
+    for (int i = 0; i < static_cast<int>(data.size()); ++i) {
+      if (data[i].size() != dimension) {
+        std::cerr << "Expected " << dimension << " columns, as in '"
+                  << args::get(centers_file) << "', at point " << i
+                  << std::endl;
+        return 1;
+      }
+    }
+    std::vector<int> occupancy(cluster_centers.size(), 0);
+    if (!args::get(occupancy_file).empty()) {
+      auto occupancy_data = ReadData(args::get(occupancy_file));
+      for (int i = 0; i < static_cast<int>(occupancy_data.size()) &&
+                      i < static_cast<int>(occupancy.size());
+           ++i) {
+        if (!occupancy_data[i].empty()) {
+          occupancy[i] = static_cast<int>(occupancy_data[i].front());
+        }
+      }
+    }
+    CapacityAssigner assigner(cluster_centers, occupancy);
+    int n = static_cast<int>(data.size());
+    int batch_size = args::get(batch) > 0 ? args::get(batch) : n;
+    std::vector<int> assignments;
+    double result = 0.0;
+    double used_time = 0.0;
+    for (int begin = 0; begin < n; begin += batch_size) {
+      std::vector<std::vector<double>> batch_data(
+          data.begin() + begin, data.begin() + std::min(n, begin + batch_size));
+      auto start_time = std::chrono::high_resolution_clock::now();
+      std::vector<int> batch_assignments;
+      double batch_result =
+          capacity ? assigner.Assign(batch_data, args::get(capacity),
+                                     &batch_assignments)
+                   : assigner.Assign(batch_data, &batch_assignments);
+      if (batch_result < 0.0) {
+        std::cerr << "Capacity exceeded at point " << begin << std::endl;
+        return 1;
+      }
+      result += batch_result;
+      used_time += std::chrono::duration_cast<std::chrono::duration<double>>(
+                       std::chrono::high_resolution_clock::now() - start_time)
+                       .count();
+      assignments.insert(assignments.end(), batch_assignments.begin(),
+                         batch_assignments.end());
+    }
+    if (!args::get(assignment_file).empty()) {
+      WriteAssignments(args::get(assignment_file) + ".csv", assignments);
+    }
+    if (!args::get(occupancy_file).empty()) {
+      WriteAssignments(args::get(occupancy_file), assigner.occupancy());
+    }
+    write_summary(args::get(seed), result, used_time);
+    std::cerr << "Sum of Squares: " << result << std::endl;
+    std::cerr << "Used Time: " << used_time << std::endl;
+    return 0;
+  }
   for (int run = 1; run <= args::get(runs); ++run) {
     auto start_time = std::chrono::high_resolution_clock::now();
     double result;
+    double cost_error_bound = -1.0;
     KMeans* k_means;
     if (args::get(type) == AlgorithmType::kLasso) {
       auto lkm = new LassoKMeans(data, args::get(k), args::get(init_method),
                                  args::get(seed) + run - 1);
+      lkm->set_sketch_dimension(args::get(sketch));
       result = lkm->Solve(args::get(lambda));
       k_means = lkm;
+    } else if (args::get(type) == AlgorithmType::kHierarchical) {
+      auto* hkm = new HierarchicalKMeans(
+          data, args::get(k), args::get(branching), refine,
+          args::get(init_method), !no_warm_start, args::get(threads),
+          args::get(seed) + run - 1, args::get(pricing_block), exact);
+      hkm->set_sketch_dimension(args::get(sketch));
+      result = hkm->Solve();
+      k_means = hkm;
     } else {
       auto* rkm = new RegularizedKMeans(
           data, args::get(k), args::get(init_method), !no_warm_start,
-          args::get(threads), args::get(seed) + run - 1);
+          args::get(threads), args::get(seed) + run - 1,
+          args::get(pricing_block), exact);
+      rkm->set_sketch_dimension(args::get(sketch));
       if (args::get(type) == AlgorithmType::kHard) {
         result = rkm->SolveHard();
       } else {
@@ -181,6 +422,7 @@ int main(int argc, char* argv[]) {
           return lambda_value * x * x;
         });
       }
+      cost_error_bound = rkm->cost_error_bound();
       k_means = rkm;
     }
     std::string run_suffix =
@@ -197,18 +439,20 @@ int main(int argc, char* argv[]) {
       WriteClusterCenters(args::get(cluster_center_file) + run_suffix + ".csv",
                           k_means->cluster_centers());
     }
-    if (!args::get(summary_file).empty()) {
-      std::fstream out;
-      out.open(args::get(summary_file), std::fstream::app);
-      out << GetKeyByValue(type_map, args::get(type)) << ',' << args::get(file)
-          << ',' << args::get(k) << ','
-          << GetKeyByValue(init_method_map, args::get(init_method)) << ','
-          << std::boolalpha << !no_warm_start << ',' << args::get(threads)
-          << ',' << args::get(seed) + run - 1 << ',' << args::get(lambda) << ','
-          << result << ',' << used_time << std::endl;
+    if (!args::get(occupancy_file).empty()) {
+      std::vector<int> cluster_size(args::get(k), 0);
+      for (auto assignment : k_means->assignments()) {
+        ++cluster_size[assignment];
+      }
+      WriteAssignments(InsertSuffix(args::get(occupancy_file), run_suffix),
+                       cluster_size);
     }
+    write_summary(args::get(seed) + run - 1, result, used_time);
     std::cerr << "Sum of Squares: " << result << std::endl;
     std::cerr << "Used Time: " << used_time << std::endl;
+    if (exact && cost_error_bound >= 0.0) {
+      std::cerr << "Cost Error Bound: " << cost_error_bound << std::endl;
+    }
     delete k_means;
   }
   return 0;
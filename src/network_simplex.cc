@@ -1,7 +1,55 @@
 #include "network_simplex.h"
 
-void NetworkSimplex::BuildHard(const std::vector<std::vector<double>>& costs,
-                               int k, int lower_bound, int upper_bound) {
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <type_traits>
+
+template <>
+bool BasicNetworkSimplex<double>::UpdateScale(
+    const std::vector<std::vector<double>>&) {
+  return false;
+}
+
+template <>
+bool BasicNetworkSimplex<int64_t>::UpdateScale(
+    const std::vector<std::vector<double>>& costs) {
+  double max_cost = max_regularizer_cost_;
+  for (const auto& row : costs) {
+    for (auto cost : row) {
+      max_cost = std::max(max_cost, std::abs(cost));
+    }
+  }
+  // Potentials are sums along tree paths of at most n + k + 1 arcs, so this
+  // keeps every potential and reduced cost within int64_t.
+  // 2^52 keeps the rounding exact in double.
+  double max_scaled_cost = std::min(
+      static_cast<double>(std::numeric_limits<int64_t>::max() / 4) /
+          (costs.size() + costs.front().size() + 1),
+      static_cast<double>(int64_t(1) << 52));
+  if (scale_ != 0.0 && max_cost * scale_ <= max_scaled_cost) {
+    return false;
+  }
+  // The callers round every arc again from its original cost.
+  scale_ = max_cost > 0.0 ? max_scaled_cost / max_cost : 1.0;
+  return true;
+}
+
+template <>
+double BasicNetworkSimplex<double>::ToCost(double cost) const {
+  return cost;
+}
+
+template <>
+int64_t BasicNetworkSimplex<int64_t>::ToCost(double cost) const {
+  return std::llround(cost * scale_);
+}
+
+template <class Cost>
+void BasicNetworkSimplex<Cost>::BuildHard(
+    const std::vector<std::vector<double>>& costs, int k, int lower_bound,
+    int upper_bound) {
   const std::vector<int>& sum_flow = BuildBasic(costs, 1);
   for (int i = 0; i < k_; ++i) {
     auto& edge = edge_list_[n_ * k_ + i];
@@ -15,8 +63,72 @@ void NetworkSimplex::BuildHard(const std::vector<std::vector<double>>& costs,
   BuildTree();
 }
 
-void NetworkSimplex::Build(const std::vector<std::vector<double>>& costs,
-                           const std::function<double(int, int)>& f) {
+template <class Cost>
+bool BasicNetworkSimplex<Cost>::BuildHard(
+    const std::vector<std::vector<double>>& costs,
+    const std::vector<int>& lower_bounds,
+    const std::vector<int>& upper_bounds) {
+  int n = static_cast<int>(costs.size());
+  int k = static_cast<int>(lower_bounds.size());
+  if (k != static_cast<int>(costs.front().size()) ||
+      !IsFeasible(n, lower_bounds, upper_bounds)) {
+    return false;
+  }
+  std::vector<int> cluster_sizes(lower_bounds);
+  int rest = n;
+  for (int i = 0; i < k; ++i) {
+    rest -= lower_bounds[i];
+  }
+  for (int i = 0; i < k && rest > 0; ++i) {
+    int extra = std::min(rest, upper_bounds[i] - lower_bounds[i]);
+    cluster_sizes[i] += extra;
+    rest -= extra;
+  }
+  const std::vector<int>& sum_flow = BuildBasic(costs, cluster_sizes, 1);
+  for (int i = 0; i < k_; ++i) {
+    auto& edge = edge_list_[n_ * k_ + i];
+    edge.from = n_ + 1 + i;
+    edge.to = 0;
+    edge.cap = upper_bounds[i] - lower_bounds[i];
+    edge.flow = sum_flow[i] - lower_bounds[i];
+    edge.cost = 0.0;
+    edge.in_tree = true;
+  }
+  BuildTree();
+  return true;
+}
+
+template <class Cost>
+bool BasicNetworkSimplex<Cost>::IsFeasible(
+    int n, const std::vector<int>& lower_bounds,
+    const std::vector<int>& upper_bounds) {
+  if (lower_bounds.size() != upper_bounds.size()) {
+    return false;
+  }
+  int64_t lower_sum = 0;
+  int64_t upper_sum = 0;
+  for (int j = 0; j < static_cast<int>(lower_bounds.size()); ++j) {
+    if (lower_bounds[j] < 0 || lower_bounds[j] > upper_bounds[j]) {
+      return false;
+    }
+    lower_sum += lower_bounds[j];
+    upper_sum += upper_bounds[j];
+  }
+  return lower_sum <= n && n <= upper_sum;
+}
+
+template <class Cost>
+void BasicNetworkSimplex<Cost>::Build(
+    const std::vector<std::vector<double>>& costs,
+    const std::function<double(int, int)>& f) {
+  f_ = f;
+  max_regularizer_cost_ = 0.0;
+  for (int i = 0; i < static_cast<int>(costs.front().size()); ++i) {
+    for (int j = 0; j < static_cast<int>(costs.size()); ++j) {
+      max_regularizer_cost_ =
+          std::max(max_regularizer_cost_, std::abs(f(i, j + 1) - f(i, j)));
+    }
+  }
   const std::vector<int>& sum_flow =
       BuildBasic(costs, static_cast<int>(costs.size()));
   for (int i = 0; i < k_; ++i) {
@@ -27,20 +139,29 @@ void NetworkSimplex::Build(const std::vector<std::vector<double>>& costs,
       edge.flow = sum_flow[i] >= j + 1;
       edge.in_tree = j == 0;
       edge.cap = 1;
-      edge.cost = f(i, j + 1) - f(i, j);
+      edge.cost = ToCost(f(i, j + 1) - f(i, j));
     }
   }
   BuildTree();
 }
 
-std::vector<int> NetworkSimplex::BuildBasic(
+template <class Cost>
+std::vector<int> BasicNetworkSimplex<Cost>::BuildBasic(
     const std::vector<std::vector<double>>& costs, int extra_edge_num_) {
+  int n = static_cast<int>(costs.size());
+  std::vector<int> sum_flow(costs.front().size(), 0);
+  for (int i = 0; i < n; ++i) {
+    ++sum_flow[i % sum_flow.size()];
+  }
+  return BuildBasic(costs, sum_flow, extra_edge_num_);
+}
+
+template <class Cost>
+std::vector<int> BasicNetworkSimplex<Cost>::BuildBasic(
+    const std::vector<std::vector<double>>& costs,
+    const std::vector<int>& cluster_sizes, int extra_edge_num_) {
   n_ = static_cast<int>(costs.size());
   k_ = static_cast<int>(costs.front().size());
-  std::vector<int> sum_flow(k_, 0);
-  for (int i = 0; i < n_; ++i) {
-    ++sum_flow[i % k_];
-  }
   int vertex_num = n_ + k_ + 1;
   int edge_num = n_ * k_ + k_ * extra_edge_num_;
   parent_.resize(vertex_num);
@@ -51,6 +172,10 @@ std::vector<int> NetworkSimplex::BuildBasic(
   potential_tag_.resize(vertex_num, -1);
   edge_list_.resize(edge_num);
   potential_tag_[0] = tag_ = 0;
+  scale_ = 0.0;
+  if (!UpdateScale(costs)) {
+    scale_ = 1.0;
+  }
   for (int i = 0; i < n_; ++i) {
     for (int j = 0; j < k_; ++j) {
       auto& edge = edge_list_[i * k_ + j];
@@ -58,19 +183,24 @@ std::vector<int> NetworkSimplex::BuildBasic(
       edge.to = n_ + 1 + j;
       edge.cap = 1;
       edge.flow = 0;
-      edge.cost = costs[i][j];
+      edge.cost = ToCost(costs[i][j]);
       edge.in_tree = false;
     }
   }
-  for (int i = 0; i < n_; ++i) {
-    int j = i % k_;
+  std::vector<int> remaining(cluster_sizes);
+  for (int i = 0, j = k_ - 1; i < n_; ++i) {
+    do {
+      j = (j + 1) % k_;
+    } while (remaining[j] == 0);
+    --remaining[j];
     edge_list_[i * k_ + j].flow = 1;
     edge_list_[i * k_ + j].in_tree = true;
   }
-  return sum_flow;
+  return cluster_sizes;
 }
 
-void NetworkSimplex::BuildTree() {
+template <class Cost>
+void BasicNetworkSimplex<Cost>::BuildTree() {
   min_cost_ = 0;
   for (int i = 0; i < static_cast<int>(edge_list_.size()); ++i) {
     min_cost_ += edge_list_[i].flow * edge_list_[i].cost;
@@ -80,9 +210,75 @@ void NetworkSimplex::BuildTree() {
       parent_direction_[edge_list_[i].from] = 1;
     }
   }
+  if (std::is_integral<Cost>::value) {
+    MakeStronglyFeasible();
+  }
+}
+
+template <class Cost>
+void BasicNetworkSimplex<Cost>::MakeStronglyFeasible() {
+  // Flow must be sendable from the root to every node along the tree. Point
+  // arcs are saturated and point upwards, which is fine, but a cluster arc to
+  // the root without flow is not, so such clusters hang from a point of the
+  // cluster with the most flow to the root.
+  int anchor = 0;
+  for (int j = 1; j < k_; ++j) {
+    if (edge_list_[parent_edge_index_[n_ + 1 + j]].flow >
+        edge_list_[parent_edge_index_[n_ + 1 + anchor]].flow) {
+      anchor = j;
+    }
+  }
+  auto& anchor_edge = edge_list_[parent_edge_index_[n_ + 1 + anchor]];
+  if (anchor_edge.flow == 0) {
+    // No cluster sends flow to the root, as when every size is fixed, so the
+    // anchor hangs from the root through an artificial arc. The root has no
+    // other arc that can carry flow, so this arc never carries any either.
+    anchor_edge.in_tree = false;
+    Edge edge;
+    edge.from = 0;
+    edge.to = n_ + 1 + anchor;
+    edge.cap = n_;
+    edge.flow = 0;
+    edge.cost = 0;
+    edge.in_tree = true;
+    parent_edge_index_[n_ + 1 + anchor] = static_cast<int>(edge_list_.size());
+    parent_direction_[n_ + 1 + anchor] = -1;
+    edge_list_.emplace_back(edge);
+  }
+  int point = 0;
+  while (point < n_ && parent_[point + 1] != n_ + 1 + anchor) {
+    ++point;
+  }
+  if (point == n_) {
+    return;
+  }
+  for (int j = 0; j < k_; ++j) {
+    auto& edge = edge_list_[parent_edge_index_[n_ + 1 + j]];
+    if (j != anchor && edge.to == 0 && edge.flow == 0) {
+      edge.in_tree = false;
+      edge_list_[point * k_ + j].in_tree = true;
+      parent_[n_ + 1 + j] = point + 1;
+      parent_edge_index_[n_ + 1 + j] = point * k_ + j;
+      parent_direction_[n_ + 1 + j] = -1;
+    }
+  }
+}
+
+template <class Cost>
+void BasicNetworkSimplex<Cost>::SetBlockPricing(int block_size, int n_jobs) {
+  block_size_ = block_size;
+  // Pricing does not depend on the number of threads, so extra threads beyond
+  // the cores would only take turns with the pivoting thread.
+  int cores = static_cast<int>(std::thread::hardware_concurrency());
+  n_jobs_ = std::max(1, cores > 0 ? std::min(n_jobs, cores) : n_jobs);
 }
 
-void NetworkSimplex::Simplex() {
+template <class Cost>
+void BasicNetworkSimplex<Cost>::Simplex() {
+  if (block_size_ > 0) {
+    BlockSimplex();
+    return;
+  }
   int num_edges = static_cast<int>(edge_list_.size());
   for (int edge_index = 0, scaned = 0; scaned < num_edges;
        ++edge_index, ++scaned) {
@@ -93,10 +289,10 @@ void NetworkSimplex::Simplex() {
     if (edge.in_tree || edge.cap == 0) {
       continue;
     }
-    double potential_from = GetPotential(edge.from);
-    double potential_to = GetPotential(edge.to);
+    Cost potential_from = GetPotential(edge.from);
+    Cost potential_to = GetPotential(edge.to);
     int direction = edge.flow == 0 ? 1 : -1;
-    double delta = (potential_to - potential_from + edge.cost) * direction;
+    Cost delta = (potential_to - potential_from + edge.cost) * direction;
     if (delta < -kEps) {
       Pivot(edge_index, direction, delta);
       scaned = 0;
@@ -104,21 +300,115 @@ void NetworkSimplex::Simplex() {
   }
 }
 
-void NetworkSimplex::UpdateCosts(
+template <class Cost>
+void BasicNetworkSimplex<Cost>::BlockSimplex() {
+  int num_edges = static_cast<int>(edge_list_.size());
+  int block_size = std::min(block_size_, num_edges);
+  int n_jobs = std::min(n_jobs_, block_size);
+  int chunk_size = (block_size + n_jobs - 1) / n_jobs;
+  std::vector<Cost> best_deltas(n_jobs);
+  std::vector<int> best_positions(n_jobs);
+  int block_start = 0;
+  if (!pool_ || pool_->n_jobs() != n_jobs) {
+    pool_.reset(new WorkerPool(n_jobs));
+  }
+  std::function<void(int)> price = [&](int t) {
+    PriceBlock(std::min(block_size, t * chunk_size),
+               std::min(block_size, (t + 1) * chunk_size), block_start,
+               &best_deltas[t], &best_positions[t]);
+  };
+  for (int scaned = 0; scaned < num_edges;
+       block_start = (block_start + block_size) % num_edges) {
+    UpdateBlockPotentials(block_start, block_start + block_size);
+    pool_->Run(price);
+    int best = 0;
+    for (int t = 1; t < n_jobs; ++t) {
+      if (best_deltas[t] < best_deltas[best]) {
+        best = t;
+      }
+    }
+    if (best_positions[best] == -1) {
+      scaned += block_size;
+      continue;
+    }
+    int edge_index = (block_start + best_positions[best]) % num_edges;
+    Pivot(edge_index, edge_list_[edge_index].flow == 0 ? 1 : -1,
+          best_deltas[best]);
+    scaned = 0;
+  }
+}
+
+template <class Cost>
+void BasicNetworkSimplex<Cost>::UpdateBlockPotentials(int begin, int end) {
+  int num_edges = static_cast<int>(edge_list_.size());
+  if (end > num_edges) {
+    UpdateBlockPotentials(begin, num_edges);
+    UpdateBlockPotentials(0, end - num_edges);
+    return;
+  }
+  for (int i = begin / k_; i < std::min(n_, (end + k_ - 1) / k_); ++i) {
+    GetPotential(i + 1);
+  }
+  for (int i = 0; i < k_; ++i) {
+    GetPotential(n_ + 1 + i);
+  }
+}
+
+template <class Cost>
+void BasicNetworkSimplex<Cost>::PriceBlock(int begin, int end, int block_start,
+                                           Cost* best_delta,
+                                           int* best_position) {
+  int num_edges = static_cast<int>(edge_list_.size());
+  *best_delta = -kEps;
+  *best_position = -1;
+  for (int position = begin; position < end; ++position) {
+    const Edge& edge = edge_list_[(block_start + position) % num_edges];
+    if (edge.in_tree || edge.cap == 0) {
+      continue;
+    }
+    int direction = edge.flow == 0 ? 1 : -1;
+    Cost delta =
+        (potential_[edge.to] - potential_[edge.from] + edge.cost) * direction;
+    if (delta < *best_delta) {
+      *best_delta = delta;
+      *best_position = position;
+    }
+  }
+}
+
+template <class Cost>
+void BasicNetworkSimplex<Cost>::UpdateCosts(
     const std::vector<std::vector<double>>& costs) {
   int n_ = static_cast<int>(costs.size());
+  bool rescaled = UpdateScale(costs);
   for (auto& edge : edge_list_) {
     if (1 <= edge.from && edge.from <= n_) {
       if (edge.flow == 1) {
-        min_cost_ += costs[edge.from - 1][edge.to - n_ - 1] - edge.cost;
+        min_cost_ += ToCost(costs[edge.from - 1][edge.to - n_ - 1]) - edge.cost;
       }
-      edge.cost = costs[edge.from - 1][edge.to - n_ - 1];
+      edge.cost = ToCost(costs[edge.from - 1][edge.to - n_ - 1]);
+    }
+  }
+  if (rescaled) {
+    if (f_) {
+      for (int i = 0; i < k_; ++i) {
+        for (int j = 0; j < n_; ++j) {
+          edge_list_[n_ * k_ + i * n_ + j].cost =
+              ToCost(f_(i, j + 1) - f_(i, j));
+        }
+      }
+    }
+    min_cost_ = 0;
+    for (const auto& edge : edge_list_) {
+      min_cost_ += edge.flow * edge.cost;
     }
   }
   potential_tag_[0] = ++tag_;
 }
 
-void NetworkSimplex::GetAssignments(std::vector<int>* assignments) const {
+template <class Cost>
+void BasicNetworkSimplex<Cost>::GetAssignments(
+    std::vector<int>* assignments) const {
   assignments->resize(n_);
   for (const auto& edge : edge_list_) {
     if (edge.flow == 1 && 1 <= edge.from && edge.from <= n_) {
@@ -127,33 +417,92 @@ void NetworkSimplex::GetAssignments(std::vector<int>* assignments) const {
   }
 }
 
-double NetworkSimplex::min_cost() const { return min_cost_; }
+template <class Cost>
+void BasicNetworkSimplex<Cost>::GetPotentials(std::vector<double>* potentials) {
+  potentials->resize(parent_.size());
+  for (int u = 0; u < static_cast<int>(parent_.size()); ++u) {
+    (*potentials)[u] = GetPotential(u) / scale_;
+  }
+}
 
-void NetworkSimplex::Pivot(int edge_index, int direction, double delta) {
+template <class Cost>
+double BasicNetworkSimplex<Cost>::min_cost() const {
+  return min_cost_ / scale_;
+}
+
+template <class Cost>
+double BasicNetworkSimplex<Cost>::cost_error_bound() const {
+  // Every point, and with a regularizer every cluster-to-root arc carrying
+  // flow, is rounded by at most 0.5 / scale in both the returned and the
+  // optimal assignment.
+  int rounded_arcs = f_ ? 2 * n_ : n_;
+  return std::is_integral<Cost>::value ? rounded_arcs / scale_ : 0.0;
+}
+
+template <class Cost>
+void BasicNetworkSimplex<Cost>::Pivot(int edge_index, int direction,
+                                      Cost delta) {
   Edge& edge = edge_list_[edge_index];
   int min_res_cap = edge.cap;
   int min_res_cap_edge_index = -1;
   int min_res_direction = 0;
   int lca = FindLca(edge.from, edge.to);
   int current_node = edge.from;
-  while (current_node != lca) {
-    int res_cap = GetParentResCap(current_node, -direction);
-    if (res_cap < min_res_cap) {
-      min_res_cap = res_cap;
-      min_res_cap_edge_index = current_node;
-      min_res_direction = 1;
+  if (std::is_integral<Cost>::value) {
+    // The leaving arc is the first blocking arc met when walking the cycle
+    // along the entering flow from the apex, which keeps the tree strongly
+    // feasible and rules out cycling on degenerate pivots.
+    from_path_.clear();
+    to_path_.clear();
+    for (; current_node != lca; current_node = parent_[current_node]) {
+      from_path_.emplace_back(current_node,
+                              GetParentResCap(current_node, -direction));
+      min_res_cap = std::min(min_res_cap, from_path_.back().second);
     }
-    current_node = parent_[current_node];
-  }
-  current_node = edge.to;
-  while (current_node != lca) {
-    int res_cap = GetParentResCap(current_node, direction);
-    if (res_cap < min_res_cap) {
-      min_res_cap = res_cap;
-      min_res_cap_edge_index = current_node;
-      min_res_direction = -1;
+    for (current_node = edge.to; current_node != lca;
+         current_node = parent_[current_node]) {
+      to_path_.emplace_back(current_node,
+                            GetParentResCap(current_node, direction));
+      min_res_cap = std::min(min_res_cap, to_path_.back().second);
+    }
+    const auto& head_path = direction == 1 ? from_path_ : to_path_;
+    const auto& tail_path = direction == 1 ? to_path_ : from_path_;
+    for (auto it = head_path.rbegin(); it != head_path.rend(); ++it) {
+      if (it->second == min_res_cap) {
+        min_res_cap_edge_index = it->first;
+        min_res_direction = direction;
+        break;
+      }
+    }
+    if (min_res_direction == 0 && edge.cap != min_res_cap) {
+      for (const auto& node : tail_path) {
+        if (node.second == min_res_cap) {
+          min_res_cap_edge_index = node.first;
+          min_res_direction = -direction;
+          break;
+        }
+      }
+    }
+  } else {
+    while (current_node != lca) {
+      int res_cap = GetParentResCap(current_node, -direction);
+      if (res_cap < min_res_cap) {
+        min_res_cap = res_cap;
+        min_res_cap_edge_index = current_node;
+        min_res_direction = 1;
+      }
+      current_node = parent_[current_node];
+    }
+    current_node = edge.to;
+    while (current_node != lca) {
+      int res_cap = GetParentResCap(current_node, direction);
+      if (res_cap < min_res_cap) {
+        min_res_cap = res_cap;
+        min_res_cap_edge_index = current_node;
+        min_res_direction = -1;
+      }
+      current_node = parent_[current_node];
     }
-    current_node = parent_[current_node];
   }
   if (min_res_cap > 0) {
     min_cost_ += min_res_cap * delta;
@@ -181,7 +530,8 @@ void NetworkSimplex::Pivot(int edge_index, int direction, double delta) {
   }
 }
 
-double NetworkSimplex::GetPotential(int u) {
+template <class Cost>
+Cost BasicNetworkSimplex<Cost>::GetPotential(int u) {
   if (potential_tag_[u] != tag_) {
     potential_[u] =
         GetPotential(parent_[u]) +
@@ -191,7 +541,8 @@ double NetworkSimplex::GetPotential(int u) {
   return potential_[u];
 }
 
-int NetworkSimplex::GetParentResCap(int u, int direction) {
+template <class Cost>
+int BasicNetworkSimplex<Cost>::GetParentResCap(int u, int direction) {
   if (direction * parent_direction_[u] > 0) {
     return edge_list_[parent_edge_index_[u]].cap -
            edge_list_[parent_edge_index_[u]].flow;
@@ -200,12 +551,15 @@ int NetworkSimplex::GetParentResCap(int u, int direction) {
   }
 }
 
-void NetworkSimplex::ApplyParentFlow(int u, int direction, int flow) {
+template <class Cost>
+void BasicNetworkSimplex<Cost>::ApplyParentFlow(int u, int direction,
+                                                int flow) {
   edge_list_[parent_edge_index_[u]].flow +=
       direction * parent_direction_[u] * flow;
 }
 
-void NetworkSimplex::ChangeDirection(int u, int end) {
+template <class Cost>
+void BasicNetworkSimplex<Cost>::ChangeDirection(int u, int end) {
   if (u != end) {
     ChangeDirection(parent_[u], end);
     parent_[parent_[u]] = u;
@@ -214,7 +568,8 @@ void NetworkSimplex::ChangeDirection(int u, int end) {
   }
 }
 
-int NetworkSimplex::FindLca(int u, int v) {
+template <class Cost>
+int BasicNetworkSimplex<Cost>::FindLca(int u, int v) {
   int t = u;
   while (t) {
     vis_[t] = true;
@@ -229,3 +584,6 @@ int NetworkSimplex::FindLca(int u, int v) {
   }
   return v;
 }
+
+template class BasicNetworkSimplex<double>;
+template class BasicNetworkSimplex<int64_t>;
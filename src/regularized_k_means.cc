@@ -3,41 +3,99 @@
 #include <algorithm>
 #include <thread>
 
+constexpr int RegularizedKMeans::kSketchCandidates;
+
 RegularizedKMeans::RegularizedKMeans(
     const std::vector<std::vector<double>>& data, int k, InitMethod init_method,
-    bool warm_start, int n_jobs, unsigned int seed)
+    bool warm_start, int n_jobs, unsigned int seed, int pricing_block,
+    bool exact)
     : KMeans(data, k, init_method, seed),
       warm_start_(warm_start),
       n_jobs_(n_jobs == -1 ? std::thread::hardware_concurrency() : n_jobs),
-      costs_(static_cast<int>(data.size()), std::vector<double>(k)) {}
+      pricing_block_(pricing_block),
+      exact_(exact),
+      costs_(static_cast<int>(data.size()), std::vector<double>(k)),
+      cost_error_bound_(0.0) {}
 
 double RegularizedKMeans::SolveHard() {
   return SolveHard(n_ / k_, (n_ + k_ - 1) / k_);
 }
 
 double RegularizedKMeans::SolveHard(int lower_bound, int upper_bound) {
-  return Solve([this, lower_bound, upper_bound]() -> NetworkSimplex {
-    NetworkSimplex ns = NetworkSimplex();
-    ns.BuildHard(this->costs_, this->k_, lower_bound, upper_bound);
-    return ns;
-  });
+  if (exact_) {
+    return Solve<ExactNetworkSimplex>(
+        [this, lower_bound, upper_bound]() -> ExactNetworkSimplex {
+          ExactNetworkSimplex ns = ExactNetworkSimplex();
+          ns.BuildHard(this->costs_, this->k_, lower_bound, upper_bound);
+          return ns;
+        });
+  }
+  return Solve<NetworkSimplex>(
+      [this, lower_bound, upper_bound]() -> NetworkSimplex {
+        NetworkSimplex ns = NetworkSimplex();
+        ns.BuildHard(this->costs_, this->k_, lower_bound, upper_bound);
+        return ns;
+      });
+}
+
+double RegularizedKMeans::SolveHard(const std::vector<int>& lower_bounds,
+                                    const std::vector<int>& upper_bounds) {
+  if (static_cast<int>(lower_bounds.size()) != k_ ||
+      !NetworkSimplex::IsFeasible(n_, lower_bounds, upper_bounds)) {
+    return -1.0;
+  }
+  if (exact_) {
+    return Solve<ExactNetworkSimplex>(
+        [this, &lower_bounds, &upper_bounds]() -> ExactNetworkSimplex {
+          ExactNetworkSimplex ns = ExactNetworkSimplex();
+          ns.BuildHard(this->costs_, lower_bounds, upper_bounds);
+          return ns;
+        });
+  }
+  return Solve<NetworkSimplex>(
+      [this, &lower_bounds, &upper_bounds]() -> NetworkSimplex {
+        NetworkSimplex ns = NetworkSimplex();
+        ns.BuildHard(this->costs_, lower_bounds, upper_bounds);
+        return ns;
+      });
 }
 
 double RegularizedKMeans::Solve(const std::function<double(int, int)>& f) {
-  return Solve([this, &f]() -> NetworkSimplex {
+  if (exact_) {
+    return Solve<ExactNetworkSimplex>([this, &f]() -> ExactNetworkSimplex {
+      ExactNetworkSimplex ns = ExactNetworkSimplex();
+      ns.Build(this->costs_, f);
+      return ns;
+    });
+  }
+  return Solve<NetworkSimplex>([this, &f]() -> NetworkSimplex {
     NetworkSimplex ns = NetworkSimplex();
     ns.Build(this->costs_, f);
     return ns;
   });
 }
 
-double RegularizedKMeans::Solve(std::function<NetworkSimplex()> builder) {
+double RegularizedKMeans::cost_error_bound() const {
+  return cost_error_bound_;
+}
+
+template <class Solver>
+double RegularizedKMeans::Solve(std::function<Solver()> builder) {
   Init();
   UpdateCostMatrix();
   std::vector<int> old_assignments;
-  NetworkSimplex ns_solver = builder();
-  ns_solver.Simplex();
-  ns_solver.GetAssignments(&assignments_);
+  Solver ns_solver = builder();
+  ns_solver.SetBlockPricing(pricing_block_, n_jobs_);
+  auto simplex = [this, &ns_solver]() {
+    ns_solver.Simplex();
+    ns_solver.GetAssignments(&assignments_);
+    while (!data_sketch_.empty() && RefineCostMatrix(ns_solver)) {
+      ns_solver.UpdateCosts(costs_);
+      ns_solver.Simplex();
+      ns_solver.GetAssignments(&assignments_);
+    }
+  };
+  simplex();
   do {
     old_assignments = assignments_;
     UpdateClusterCenter();
@@ -46,15 +104,37 @@ double RegularizedKMeans::Solve(std::function<NetworkSimplex()> builder) {
       ns_solver.UpdateCosts(costs_);
     } else {
       ns_solver = builder();
+      ns_solver.SetBlockPricing(pricing_block_, n_jobs_);
     }
-    ns_solver.Simplex();
-    ns_solver.GetAssignments(&assignments_);
+    simplex();
   } while (old_assignments != assignments_);
+  cost_error_bound_ = ns_solver.cost_error_bound();
   return GetSumSquaredError();
 }
 
 void RegularizedKMeans::UpdateCostMatrix() {
-  if (n_jobs_ <= 1) {
+  if (!data_sketch_.empty()) {
+    UpdateCenterSketch();
+    exact_costs_.resize(n_);
+    if (n_jobs_ <= 1) {
+      for (int i = 0; i < n_; ++i) {
+        UpdateScreenedCosts(i);
+      }
+    } else {
+      std::vector<std::thread> threads(n_jobs_);
+      for (int t = 0; t < n_jobs_; ++t) {
+        threads[t] = std::thread(std::bind(
+            [this](int thread_idx) {
+              for (int i = thread_idx; i < n_; i += n_jobs_) {
+                UpdateScreenedCosts(i);
+              }
+            },
+            t));
+      }
+      std::for_each(threads.begin(), threads.end(),
+                    [](std::thread& x) { x.join(); });
+    }
+  } else if (n_jobs_ <= 1) {
     for (int i = 0; i < n_; ++i) {
       for (int j = 0; j < k_; ++j) {
         costs_[i][j] = CalDistance(data_[i], cluster_centers_[j]);
@@ -77,3 +157,53 @@ void RegularizedKMeans::UpdateCostMatrix() {
                   [](std::thread& x) { x.join(); });
   }
 }
+
+void RegularizedKMeans::UpdateScreenedCosts(int i) {
+  exact_costs_[i].assign(k_, false);
+  std::vector<std::pair<double, int>> bounds(k_);
+  for (int j = 0; j < k_; ++j) {
+    bounds[j] = std::make_pair(
+        CalSketchDistance(data_sketch_[i], cluster_center_sketch_[j]), j);
+    costs_[i][j] =
+        CalSketchUpperBound(data_sketch_[i], cluster_center_sketch_[j]);
+  }
+  int assignment = assignments_[i];
+  double threshold = CalDistance(data_[i], cluster_centers_[assignment]);
+  costs_[i][assignment] = threshold;
+  exact_costs_[i][assignment] = true;
+  int candidate_num = std::min(k_, kSketchCandidates);
+  std::nth_element(bounds.begin(), bounds.begin() + candidate_num - 1,
+                   bounds.end());
+  for (int c = 0; c < k_; ++c) {
+    int j = bounds[c].second;
+    if (!exact_costs_[i][j] &&
+        (c < candidate_num || bounds[c].first <= threshold)) {
+      costs_[i][j] = CalDistance(data_[i], cluster_centers_[j]);
+      exact_costs_[i][j] = true;
+    }
+  }
+}
+
+template <class Solver>
+bool RegularizedKMeans::RefineCostMatrix(Solver& ns_solver) {
+  std::vector<double> potentials;
+  ns_solver.GetPotentials(&potentials);
+  bool changed = false;
+  for (int i = 0; i < n_; ++i) {
+    for (int j = 0; j < k_; ++j) {
+      if (exact_costs_[i][j]) {
+        continue;
+      }
+      double reduced_cost = potentials[n_ + 1 + j] - potentials[i + 1];
+      if (assignments_[i] == j ||
+          CalSketchDistance(data_sketch_[i], cluster_center_sketch_[j]) +
+                  reduced_cost <
+              0.0) {
+        costs_[i][j] = CalDistance(data_[i], cluster_centers_[j]);
+        exact_costs_[i][j] = true;
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
@@ -0,0 +1,142 @@
+#include "streaming_k_means.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "k_means.h"
+#include "network_simplex.h"
+
+StreamingKMeans::StreamingKMeans(ChunkReader* reader, int k, int chunk_size,
+                                 unsigned int seed)
+    : reader_(reader),
+      k_(k),
+      chunk_size_(chunk_size),
+      s_(0),
+      n_(0),
+      el_(seed) {}
+
+const std::vector<std::vector<double>>& StreamingKMeans::cluster_centers()
+    const {
+  return this->cluster_centers_;
+}
+
+bool StreamingKMeans::Init() {
+  // Reservoir sampling keeps k uniformly drawn points over one pass.
+  cluster_centers_.clear();
+  n_ = 0;
+  std::vector<std::vector<double>> chunk;
+  reader_->Reset();
+  while (reader_->Read(chunk_size_, &chunk)) {
+    for (auto& point : chunk) {
+      if (n_ < k_) {
+        cluster_centers_.push_back(std::move(point));
+      } else {
+        std::uniform_int_distribution<int> uid(0, n_);
+        int index = uid(el_);
+        if (index < k_) {
+          cluster_centers_[index] = std::move(point);
+        }
+      }
+      ++n_;
+    }
+  }
+  if (n_ < k_) {
+    return false;
+  }
+  s_ = static_cast<int>(cluster_centers_.front().size());
+  cluster_sizes_.assign(k_, 0);
+  return true;
+}
+
+double StreamingKMeans::Solve(int passes) {
+  if (!Init()) {
+    return -1.0;
+  }
+  double result = 0.0;
+  for (int pass = 0; pass < passes; ++pass) {
+    std::vector<std::vector<double>> sums(k_, std::vector<double>(s_, 0.0));
+    std::vector<int> counts(k_, 0);
+    std::vector<std::vector<double>> chunk;
+    std::vector<int> assignments;
+    std::vector<int> capacity = Capacity();
+    auto old_cluster_centers = cluster_centers_;
+    result = 0.0;
+    reader_->Reset();
+    while (reader_->Read(chunk_size_, &chunk)) {
+      result += AssignChunk(chunk, &capacity, &assignments);
+      for (int i = 0; i < static_cast<int>(chunk.size()); ++i) {
+        ++counts[assignments[i]];
+        for (int j = 0; j < s_; ++j) {
+          sums[assignments[i]][j] += chunk[i][j];
+        }
+      }
+      for (int i = 0; i < k_; ++i) {
+        if (counts[i] > 0) {
+          for (int j = 0; j < s_; ++j) {
+            cluster_centers_[i][j] = sums[i][j] / counts[i];
+          }
+        }
+      }
+    }
+    cluster_sizes_ = counts;
+    if (old_cluster_centers == cluster_centers_) {
+      break;
+    }
+  }
+  return result;
+}
+
+double StreamingKMeans::Assign(const std::function<void(int)>& output) {
+  std::vector<int> capacity = Capacity();
+  double result = 0.0;
+  std::vector<std::vector<double>> chunk;
+  std::vector<int> assignments;
+  reader_->Reset();
+  while (reader_->Read(chunk_size_, &chunk)) {
+    result += AssignChunk(chunk, &capacity, &assignments);
+    for (auto assignment : assignments) {
+      output(assignment);
+    }
+  }
+  return result;
+}
+
+std::vector<int> StreamingKMeans::Capacity() const {
+  // The ceil(n/k) targets go to the clusters that were largest in the last
+  // pass. The targets sum to n, so every chunk can be filled from the
+  // capacity left and the sizes meet the global bounds.
+  std::vector<int> order(k_);
+  for (int i = 0; i < k_; ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+    return cluster_sizes_[a] > cluster_sizes_[b];
+  });
+  std::vector<int> capacity(k_, n_ / k_);
+  for (int i = 0; i < n_ % k_; ++i) {
+    ++capacity[order[i]];
+  }
+  return capacity;
+}
+
+double StreamingKMeans::AssignChunk(
+    const std::vector<std::vector<double>>& chunk, std::vector<int>* capacity,
+    std::vector<int>* assignments) const {
+  int n = static_cast<int>(chunk.size());
+  std::vector<std::vector<double>> costs(n, std::vector<double>(k_));
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < k_; ++j) {
+      costs[i][j] = KMeans::CalDistance(chunk[i], cluster_centers_[j]);
+    }
+  }
+  NetworkSimplex ns_solver = NetworkSimplex();
+  ns_solver.BuildHard(costs, std::vector<int>(k_, 0), *capacity);
+  ns_solver.Simplex();
+  ns_solver.GetAssignments(assignments);
+  double result = 0.0;
+  for (int i = 0; i < n; ++i) {
+    result += costs[i][(*assignments)[i]];
+    --(*capacity)[(*assignments)[i]];
+  }
+  return result;
+}
@@ -0,0 +1,79 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+constexpr int WorkerPool::kSpinCount;
+
+WorkerPool::WorkerPool(int n_jobs)
+    : n_jobs_(std::max(1, n_jobs)),
+      task_(nullptr),
+      round_(0),
+      pending_(0),
+      stop_(false) {
+  for (int t = 1; t < n_jobs_; ++t) {
+    threads_.emplace_back(&WorkerPool::Work, this, t);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    round_.fetch_add(1, std::memory_order_release);
+  }
+  start_.notify_all();
+  std::for_each(threads_.begin(), threads_.end(),
+                [](std::thread& x) { x.join(); });
+}
+
+int WorkerPool::n_jobs() const { return n_jobs_; }
+
+void WorkerPool::Run(const std::function<void(int)>& task) {
+  if (n_jobs_ == 1) {
+    task(0);
+    return;
+  }
+  task_ = &task;
+  pending_.store(n_jobs_ - 1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    round_.fetch_add(1, std::memory_order_release);
+  }
+  start_.notify_all();
+  task(0);
+  for (int spin = 0; spin < kSpinCount &&
+                     pending_.load(std::memory_order_acquire) > 0;
+       ++spin) {
+    std::this_thread::yield();
+  }
+  if (pending_.load(std::memory_order_acquire) > 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() {
+      return pending_.load(std::memory_order_acquire) == 0;
+    });
+  }
+}
+
+void WorkerPool::Work(int t) {
+  for (int last_round = 0;; ++last_round) {
+    for (int spin = 0; spin < kSpinCount &&
+                       round_.load(std::memory_order_acquire) == last_round;
+         ++spin) {
+      std::this_thread::yield();
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [this, last_round]() {
+        return round_.load(std::memory_order_acquire) != last_round;
+      });
+      if (stop_) {
+        return;
+      }
+    }
+    (*task_)(t);
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_.notify_one();
+    }
+  }
+}